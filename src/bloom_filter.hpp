@@ -0,0 +1,138 @@
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+namespace ineffa {
+
+struct bloom_filter_stats {
+    size_t memory_bytes = 0;
+    double false_positive_rate = 0;  // Expected for a key that is not in the map
+};
+
+// Prefilter of flat_hash_map that lets every lookup through
+struct no_prefilter {
+    static constexpr bool enabled = false;
+
+    void reset(uint32_t) noexcept {}
+    void clear() noexcept {}
+    void insert(uint64_t) noexcept {}
+    constexpr bool may_contain(uint64_t) const noexcept { return true; }
+    constexpr bool note_erase(uint32_t) noexcept { return false; }
+};
+
+// Split block Bloom filter over the full 64-bit key hashes of flat_hash_map. Each key sets one bit
+// in each of the 8 words of a single 32-byte block, so a lookup touches one cache line.
+// The high half of the hash picks the block and the low half the bits, so the two are independent.
+template <uint32_t bits_per_key = 10>
+class blocked_bloom_filter {
+private:
+    struct alignas(32) block_t {
+        uint32_t words[8] = {};
+    };
+
+    static constexpr uint32_t salts[8] = {
+        0x47b6137bu, 0x44974d91u, 0x8824ad5bu, 0xa2b7289du,
+        0x705495c7u, 0x2df1424bu, 0x9efc4947u, 0x5c6bfb31u
+    };
+
+    std::unique_ptr<block_t[]> blocks_ = nullptr;
+    uint32_t block_count_ = 0;
+    uint32_t key_count_ = 0;   // Keys inserted since the last reset, erased ones included
+    uint32_t stale_keys_ = 0;  // Erased keys whose bits are still set
+
+    auto block_of(const uint64_t hash) const noexcept -> block_t& {
+        return blocks_[((hash >> 32) * (uint64_t)block_count_) >> 32];
+    }
+
+    static auto bit_of(const uint64_t hash, const uint32_t word) noexcept -> uint32_t {
+        return uint32_t(1) << (((uint32_t)hash * salts[word]) >> 27);
+    }
+
+public:
+    static constexpr bool enabled = true;
+
+    blocked_bloom_filter() noexcept = default;
+
+    // A moved-from filter is empty, so that stats() never reads the blocks it gave away
+    blocked_bloom_filter(blocked_bloom_filter&& other) noexcept :
+        blocks_(std::move(other.blocks_)),
+        block_count_(std::exchange(other.block_count_, 0)),
+        key_count_(std::exchange(other.key_count_, 0)),
+        stale_keys_(std::exchange(other.stale_keys_, 0))
+    {}
+
+    auto operator=(blocked_bloom_filter&& other) noexcept -> blocked_bloom_filter& {
+        if (this != &other) [[likely]] {
+            blocks_ = std::move(other.blocks_);
+            block_count_ = std::exchange(other.block_count_, 0);
+            key_count_ = std::exchange(other.key_count_, 0);
+            stale_keys_ = std::exchange(other.stale_keys_, 0);
+        }
+        return *this;
+    }
+
+    blocked_bloom_filter(const blocked_bloom_filter&) = delete;
+    blocked_bloom_filter& operator=(const blocked_bloom_filter&) = delete;
+
+    // Sized for a table of `capacity` slots filled up to its 7/8 load factor
+    void reset(const uint32_t capacity) {
+        const uint64_t bit_count = (uint64_t)capacity * 7 / 8 * bits_per_key;
+        const uint32_t block_count = (uint32_t)std::max<uint64_t>(1, (bit_count + 255) / 256);
+        blocks_ = std::make_unique<block_t[]>(block_count);
+        block_count_ = block_count;
+        key_count_ = 0;
+        stale_keys_ = 0;
+    }
+
+    void clear() noexcept {
+        if (blocks_ != nullptr)
+            std::fill_n(blocks_.get(), block_count_, block_t {});
+        key_count_ = 0;
+        stale_keys_ = 0;
+    }
+
+    void insert(const uint64_t hash) noexcept {
+        block_t& block = block_of(hash);
+        for (uint32_t i = 0; i < 8; i++)
+            block.words[i] |= bit_of(hash, i);
+        key_count_++;
+    }
+
+    auto may_contain(const uint64_t hash) const noexcept -> bool {
+        const block_t& block = block_of(hash);
+        for (uint32_t i = 0; i < 8; i++)
+            if ((block.words[i] & bit_of(hash, i)) == 0)
+                return false;
+        return true;
+    }
+
+    // Returns whether the filter should be rebuilt because more keys were erased than are left
+    auto note_erase(const uint32_t size) noexcept -> bool {
+        return ++stale_keys_ > size;
+    }
+
+    auto stats() const noexcept -> bloom_filter_stats {
+        bloom_filter_stats stats = { .memory_bytes = sizeof(block_t) * block_count_ };
+        if (block_count_ == 0)
+            return stats;
+
+        // An absent key is a false positive if the 8 bits it probes happen to be set
+        for (uint32_t idx = 0; idx < block_count_; idx++) {
+            double probability = 1;
+            for (const uint32_t word : blocks_[idx].words)
+                probability *= std::popcount(word) / 32.0;
+            stats.false_positive_rate += probability;
+        }
+        stats.false_positive_rate /= block_count_;
+
+        // An absent key whose full hash equals that of an inserted key passes regardless of the bits
+        const double collision_rate = key_count_ / 18446744073709551616.0;
+        stats.false_positive_rate += (1 - stats.false_positive_rate) * collision_rate;
+        return stats;
+    }
+};
+
+} // namespace ineffa
@@ -0,0 +1,131 @@
+#pragma once
+#include <atomic>
+#include <optional>
+#include <stdexcept>
+#include <tuple>
+#include "./flat_hash_map.hpp"
+
+namespace ineffa {
+
+// Insert-only hash map with a fixed capacity, meant for parallel build phases.
+// Threads claim slots with a CAS on the ctrl word and probe linearly without displacement.
+// Probing never blocks, except that a thread meeting a slot with the same hash whose kv another
+// thread is still constructing has to wait until that insert is published.
+// Once all writers are done, freeze() turns the table into a flat_hash_map in place.
+template <typename Key, typename Value, typename Hash = ineffa::hash<Key>, typename KeyEqual = std::equal_to<>>
+requires hashable<Hash, Key>
+class concurrent_flat_hash_map {
+public:
+    using map_type    = flat_hash_map<Key, Value, Hash, KeyEqual>;
+    using key_type    = typename map_type::key_type;
+    using mapped_type = typename map_type::mapped_type;
+    using size_type   = typename map_type::size_type;
+
+private:
+    using ctrl_slot_t = typename map_type::ctrl_slot_t;
+    using kv_slot_t   = typename map_type::kv_slot_t;
+    using query_type  = typename map_type::template key_type_trait<Hash, Key>::query_type;
+
+    // A claimed slot whose kv is still being constructed
+    static constexpr size_type BUSY_DIB = ctrl_slot_t::EMPTY_DIB - 1;
+
+    static_assert(std::atomic_ref<ctrl_slot_t>::is_always_lock_free);
+    static_assert(alignof(ctrl_slot_t) >= std::atomic_ref<ctrl_slot_t>::required_alignment);
+
+    map_type map_;
+
+    // The writer may be descheduled mid-construction, so wait() backs off to sleeping
+    // instead of spinning away the timeslice it needs. Writers notify after publishing.
+    static void wait_published(std::atomic_ref<ctrl_slot_t> ctrl, ctrl_slot_t ctrl_slot) noexcept {
+        while (ctrl_slot.dib == BUSY_DIB) [[unlikely]] {
+            ctrl.wait(ctrl_slot, std::memory_order_acquire);
+            ctrl_slot = ctrl.load(std::memory_order_acquire);
+        }
+    }
+
+public:
+    explicit concurrent_flat_hash_map(const size_type expected_size) {
+        size_type required_capacity = 8;
+        for (; required_capacity * 7 / 8 < expected_size; required_capacity = required_capacity * 3 / 2);
+        map_.rehash(required_capacity);
+    }
+
+    // Safe to call from many threads at once. Throws std::length_error when no empty slot is left.
+    template <typename... Args>
+    auto insert_or_get(query_type key, Args&&... args) -> std::pair<mapped_type&, bool> {
+        auto ctrl_slots = map_.get_ctrl_slots();
+        auto kv_slots = map_.get_kv_slots();
+        const size_type capacity = map_.capacity_;
+        const size_type hash = (size_type)map_.hash_of(key);
+        size_type idx = ((uint64_t)hash * (uint64_t)capacity) >> 32;
+        std::optional<typename kv_slot_t::kv_type> new_kv;
+
+        for (size_type dib = 0; dib < capacity; dib++) {
+            std::atomic_ref<ctrl_slot_t> ctrl(ctrl_slots[idx]);
+            ctrl_slot_t ctrl_slot = ctrl.load(std::memory_order_acquire);
+
+            if (ctrl_slot.is_empty()) {
+                // Constructed before claiming, so that a throwing constructor never leaves a claimed slot behind
+                if (!new_kv.has_value())
+                    new_kv.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(std::forward<Args>(args)...));
+
+                if (ctrl.compare_exchange_strong(ctrl_slot, ctrl_slot_t { .hash = hash, .dib = BUSY_DIB }, std::memory_order_acq_rel, std::memory_order_acquire)) {
+                    std::construct_at(kv_slots[idx].kv_ptr(), std::move(*new_kv));
+                    ctrl.store(ctrl_slot_t { .hash = hash, .dib = dib }, std::memory_order_release);
+                    ctrl.notify_all();
+                    return { kv_slots[idx].value(), true };
+                }
+            }
+
+            if (ctrl_slot.hash == hash) [[unlikely]] {
+                wait_published(ctrl, ctrl_slot);
+                if (map_.is_key_equal_(kv_slots[idx].key(), key)) [[likely]]
+                    return { kv_slots[idx].value(), false };
+            }
+
+            idx = idx + 1 == capacity ? 0 : idx + 1;
+        }
+
+        throw std::length_error("concurrent_flat_hash_map capacity exceeded");
+    }
+
+    // Safe to call concurrently with insert_or_get, blocks only on an in-flight insert of the same hash.
+    // Returns nullptr if the key is not present.
+    auto find(query_type key) noexcept -> mapped_type* {
+        auto ctrl_slots = map_.get_ctrl_slots();
+        auto kv_slots = map_.get_kv_slots();
+        const size_type capacity = map_.capacity_;
+        const size_type hash = (size_type)map_.hash_of(key);
+        size_type idx = ((uint64_t)hash * (uint64_t)capacity) >> 32;
+
+        for (size_type dib = 0; dib < capacity; dib++) {
+            std::atomic_ref<ctrl_slot_t> ctrl(ctrl_slots[idx]);
+            ctrl_slot_t ctrl_slot = ctrl.load(std::memory_order_acquire);
+
+            if (ctrl_slot.is_empty())
+                break;
+
+            if (ctrl_slot.hash == hash) [[unlikely]] {
+                wait_published(ctrl, ctrl_slot);
+                if (map_.is_key_equal_(kv_slots[idx].key(), key)) [[likely]]
+                    return &kv_slots[idx].value();
+            }
+
+            idx = idx + 1 == capacity ? 0 : idx + 1;
+        }
+
+        return nullptr;
+    }
+
+    auto contains(query_type key) noexcept -> bool { return find(key) != nullptr; }
+
+    auto capacity() const noexcept -> size_type { return map_.capacity_; }
+
+    // Must not race with any other call. Entries are only reordered within their clusters, never copied to a new table.
+    auto freeze() && -> map_type {
+        map_.restore_robin_hood_order();
+        return std::move(map_);
+    }
+};
+
+} // namespace ineffa
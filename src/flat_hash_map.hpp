@@ -1,19 +1,44 @@
 #pragma once
+#include <bit>
+#include <cstddef>
+#include <cstring>
 #include <memory>
+#include <new>
+#include <random>
 #include <string_view>
 #include <type_traits>
 #include <utility>
+#include "./bloom_filter.hpp"
 #include "./hash.hpp"
+#include "./type_traits.hpp"
 
 namespace ineffa {
 
-template <typename Key, typename Value, typename Hash = ineffa::hash<Key>, typename KeyEqual = std::equal_to<>>
+// Slot layouts of flat_hash_map
+struct soa_layout {};  // All ctrl slots first, then all kv slots. Probing scans densely packed ctrl slots.
+struct aos_layout {};  // Each ctrl slot is directly followed by its kv slot. A hit on small entries usually costs one cache miss.
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+requires hashable<Hash, Key>
+class concurrent_flat_hash_map;
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
 requires hashable<Hash, Key>
+class indirect_hash_map;
+
+template <typename Key, typename Value, typename Hash = ineffa::hash<Key>, typename KeyEqual = std::equal_to<>, typename Layout = soa_layout, typename Prefilter = no_prefilter>
+requires hashable<Hash, Key> && (std::same_as<Layout, soa_layout> || std::same_as<Layout, aos_layout>)
 class flat_hash_map {
 private:
     template <bool is_const>
     class iterator_impl_t;
 
+    friend class concurrent_flat_hash_map<Key, Value, Hash, KeyEqual>;
+
+    template <typename K, typename V, typename H, typename E>
+    requires hashable<H, K>
+    friend class indirect_hash_map;
+
 public:
     using key_type        = Key;
     using mapped_type     = Value;
@@ -30,7 +55,7 @@ public:
     using const_iterator  = iterator_impl_t<true>;
 
 private:
-    struct ctrl_slot_t {
+    struct alignas(sizeof(size_type) * 2) ctrl_slot_t {
         static constexpr size_type EMPTY_DIB = std::numeric_limits<size_type>::max();
 
         size_type hash = 0;
@@ -59,6 +84,42 @@ private:
     static_assert(std::is_nothrow_move_assignable_v<typename kv_slot_t::kv_type>);
     static_assert(std::is_nothrow_destructible_v<typename kv_slot_t::kv_type>);
 
+    static constexpr bool is_interleaved = std::is_same_v<Layout, aos_layout>;
+
+    struct interleaved_slot_t {
+        ctrl_slot_t ctrl;
+        kv_slot_t kv;
+    };
+
+    // Indexes the ctrl or kv slots like a plain array, whichever layout they are stored in
+    template <typename T>
+    class slot_array_t {
+    private:
+        static constexpr size_t stride = is_interleaved ? sizeof(interleaved_slot_t) : sizeof(T);
+        std::byte* data_;
+
+    public:
+        explicit slot_array_t(std::byte* data) noexcept : data_(data) {}
+
+        auto operator[](const size_type idx) const noexcept -> T& {
+            return *std::launder((T*)std::assume_aligned<alignof(T)>(data_ + (size_t)idx * stride));
+        }
+    };
+
+    static constexpr auto kv_slots_offset(const size_type capacity) noexcept -> size_t {
+        if constexpr (is_interleaved)
+            return offsetof(interleaved_slot_t, kv);
+        else
+            return (sizeof(ctrl_slot_t) * capacity + alignof(kv_slot_t) - 1) & ~(alignof(kv_slot_t) - 1);
+    }
+
+    static constexpr auto data_size(const size_type capacity) noexcept -> size_t {
+        if constexpr (is_interleaved)
+            return sizeof(interleaved_slot_t) * capacity;
+        else
+            return kv_slots_offset(capacity) + sizeof(kv_slot_t) * capacity;
+    }
+
     struct aligned_deleter {
         void operator()(std::byte* ptr) const noexcept {
             ::operator delete[](ptr, std::align_val_t { std::max(alignof(ctrl_slot_t), alignof(kv_slot_t)) });
@@ -68,35 +129,182 @@ private:
     std::unique_ptr<std::byte[], aligned_deleter> data_ = nullptr;
     size_type size_ = 0;
     size_type capacity_ = 0;
+    size_type max_dib_ = 0;  // Upper bound of the dib of all slots
+    uint64_t seed_ = 0;      // Only used if the hash function accepts a seed, 0 until the first allocation picks one
 
     #if defined(_MSC_VER)
         [[msvc::no_unique_address]] Hash hash_func_ = {};
         [[msvc::no_unique_address]] KeyEqual is_key_equal_ = {};
+        [[msvc::no_unique_address]] Prefilter prefilter_ = {};
     #else
         [[no_unique_address]] Hash hash_func_ = {};
         [[no_unique_address]] KeyEqual is_key_equal_ = {};
+        [[no_unique_address]] Prefilter prefilter_ = {};
     #endif
 
+    static constexpr bool is_kv_relocatable = is_trivially_relocatable_v<typename kv_slot_t::kv_type>;
+
+    // The full hash, the ctrl slots keep its low bits and the prefilter uses all of them
+    template <typename K>
+    inline auto hash_of(const K& key) const noexcept -> uint64_t {
+        if constexpr (seedable_hash<Hash, Key>)
+            return (uint64_t)hash_func_(key, seed_);
+        else
+            return (uint64_t)hash_func_(key);
+    }
+
+    // A std::random_device draw per map would cost more than building a small map,
+    // so every thread draws once and derives the seeds of its maps from a counter
+    static auto random_seed() -> uint64_t {
+        thread_local uint64_t counter = ((uint64_t)std::random_device {}() << 32) | std::random_device {}();
+        return ineffa::hash<uint64_t> {}(counter++);
+    }
+
+    // Robin Hood probing with a decent hash keeps the longest probe sequence at O(log n),
+    // anything far beyond that means the hash function clusters on the current key set
+    inline auto max_dib_limit() const noexcept -> size_type {
+        return 16 + 4 * (size_type)std::bit_width(capacity_);
+    }
+
+    // Records the largest dib placed by an insertion. If it crosses the limit, the table is
+    // rebuilt with a fresh seed, or grown if the hash function takes no seed. Returns whether
+    // the table was rebuilt, which invalidates all slot indices.
+    auto record_dib(const size_type dib) -> bool {
+        if (dib <= max_dib_) [[likely]]
+            return false;
+
+        max_dib_ = dib;
+        if (max_dib_ <= max_dib_limit()) [[likely]]
+            return false;
+
+        bool rebuilt = false;
+        try {
+            if constexpr (seedable_hash<Hash, Key>) {
+                rehash(capacity_, random_seed());
+                if (max_dib_ <= max_dib_limit())
+                    return true;
+                rebuilt = true;
+            }
+
+            // Growing a sparse table would only waste memory on keys that collide anyway
+            if (size_ < capacity_ / 2)
+                return rebuilt;
+
+            rehash(capacity_ * 3 / 2);
+            return true;
+        }
+        catch (const std::bad_alloc&) {
+            // The insertion already succeeded and a failed rehash leaves the table untouched,
+            // so keep the long probe sequences rather than failing an insertion that took place
+            return rebuilt;
+        }
+    }
+
     inline void destroy_kv(ctrl_slot_t& ctrl_slot, kv_slot_t& kv_slot) noexcept {
         std::destroy_at(kv_slot.kv_ptr());
         ctrl_slot.dib = ctrl_slot_t::EMPTY_DIB;
     }
 
-    void insert_for_rehash(const size_type hash, kv_slot_t::kv_type&& kv) noexcept {
-        ctrl_slot_t* __restrict ctrl_slots = get_ctrl_slots();
+    // Moves the kv of `src` into the uninitialized `dst` and ends its lifetime in `src`
+    static inline void relocate_kv(kv_slot_t& dst, kv_slot_t& src) noexcept {
+        if constexpr (is_kv_relocatable)
+            std::memcpy(&dst, &src, sizeof(kv_slot_t));
+        else {
+            std::construct_at(dst.kv_ptr(), std::move(src.kv()));
+            std::destroy_at(src.kv_ptr());
+        }
+    }
+
+    void rebuild_prefilter() noexcept {
+        if constexpr (Prefilter::enabled) {
+            auto ctrl_slots = get_ctrl_slots();
+            auto kv_slots = get_kv_slots();
+            prefilter_.clear();
+            for (size_type idx = 0; idx < capacity_; idx++)
+                if (!ctrl_slots[idx].is_empty())
+                    prefilter_.insert(hash_of(kv_slots[idx].key()));
+        }
+    }
+
+    void erase_slot(size_type idx) noexcept {
+        auto ctrl_slots = get_ctrl_slots();
+        auto kv_slots = get_kv_slots();
+
+        size_--;
+        destroy_kv(ctrl_slots[idx], kv_slots[idx]);
+
+        // Length of the run that has to be shifted back by one slot
+        size_type count = 0;
+        for (size_type next_idx = idx + 1 == capacity_ ? 0 : idx + 1; !ctrl_slots[next_idx].is_empty() && ctrl_slots[next_idx].dib != 0; ) {
+            ctrl_slots[next_idx].dib--;
+            count++;
+            next_idx = next_idx + 1 == capacity_ ? 0 : next_idx + 1;
+        }
+
+        while (count > 0) {
+            if (idx + 1 == capacity_) [[unlikely]] {
+                ctrl_slots[idx] = ctrl_slots[0];
+                relocate_kv(kv_slots[idx], kv_slots[0]);
+                idx = 0;
+                count--;
+                continue;
+            }
+
+            const size_type n = std::min(count, capacity_ - 1 - idx);
+            shift_slots_back(idx, n);
+            idx += n;
+            count -= n;
+        }
+
+        ctrl_slots[idx].dib = ctrl_slot_t::EMPTY_DIB;
+
+        if (prefilter_.note_erase(size_)) [[unlikely]]
+            rebuild_prefilter();
+    }
+
+    // Moves the `count` slots after `idx` back by one, the range must not wrap around
+    void shift_slots_back(const size_type idx, const size_type count) noexcept {
+        auto ctrl_slots = get_ctrl_slots();
+        auto kv_slots = get_kv_slots();
+
+        if constexpr (is_interleaved && is_kv_relocatable)
+            std::memmove(&ctrl_slots[idx], &ctrl_slots[idx + 1], sizeof(interleaved_slot_t) * count);
+        else if constexpr (is_kv_relocatable) {
+            std::memmove(&ctrl_slots[idx], &ctrl_slots[idx + 1], sizeof(ctrl_slot_t) * count);
+            std::memmove(&kv_slots[idx], &kv_slots[idx + 1], sizeof(kv_slot_t) * count);
+        }
+        else
+            for (size_type i = idx; i < idx + count; i++) {
+                ctrl_slots[i] = ctrl_slots[i + 1];
+                relocate_kv(kv_slots[i], kv_slots[i + 1]);
+            }
+    }
+
+    static inline void swap_kv(kv_slot_t& lhs, kv_slot_t& rhs) noexcept {
+        if constexpr (is_kv_relocatable)
+            std::swap(lhs, rhs);  // Swaps the raw bytes
+        else
+            std::swap(lhs.kv(), rhs.kv());
+    }
+
+    // Relocates the kv held by `kv` into the table
+    void insert_for_rehash(const size_type hash, kv_slot_t& kv) noexcept {
+        auto ctrl_slots = get_ctrl_slots();
         ctrl_slot_t ctrl_slot = { .hash = hash, .dib = 0 };
         size_type idx = ((uint64_t)hash * (uint64_t)capacity_) >> 32;
 
         while (true) {
             if (ctrl_slots[idx].is_empty()) {
+                max_dib_ = std::max(max_dib_, ctrl_slot.dib);
                 ctrl_slots[idx] = ctrl_slot;
-                std::construct_at(get_kv_slots()[idx].kv_ptr(), std::move(kv));
+                relocate_kv(get_kv_slots()[idx], kv);
                 return;
             }
 
             if (ctrl_slots[idx].dib < ctrl_slot.dib) {
+                max_dib_ = std::max(max_dib_, ctrl_slot.dib);
                 std::swap(ctrl_slots[idx], ctrl_slot);
-                std::swap(get_kv_slots()[idx].kv(), kv);
+                swap_kv(get_kv_slots()[idx], kv);
             }
 
             idx = idx + 1 == capacity_ ? 0 : idx + 1;
@@ -105,37 +313,111 @@ private:
     }
 
     void rehash(size_type new_capacity) {
+        rehash(new_capacity, seed_);
+    }
+
+    // Recomputes the hash of every key if `new_seed` differs from the current seed. The seed is only
+    // replaced once all allocations succeeded, so a throwing rehash leaves the map as it was.
+    // The prefilter needs the full hashes, which the ctrl slots do not keep, so it always recomputes them.
+    void rehash(size_type new_capacity, uint64_t new_seed) {
+        if constexpr (seedable_hash<Hash, Key>)
+            if (capacity_ == 0 && new_seed == 0)
+                new_seed = random_seed();
+
         constexpr size_type alignment = std::max(alignof(ctrl_slot_t), alignof(kv_slot_t));
-        const size_type new_data_size = ((sizeof(ctrl_slot_t) * new_capacity + alignof(kv_slot_t) - 1) & ~(alignof(kv_slot_t) - 1)) + sizeof(kv_slot_t) * new_capacity;
-        std::byte* new_data_mem = (std::byte*)::operator new[](new_data_size, std::align_val_t(alignment));
+        std::byte* new_data_mem = (std::byte*)::operator new[](data_size(new_capacity), std::align_val_t(alignment));
         auto new_data = std::unique_ptr<std::byte[], aligned_deleter>(new_data_mem);
 
-        const ctrl_slot_t* __restrict const old_ctrl_slots = get_ctrl_slots();
-        kv_slot_t* __restrict const old_kv_slots = get_kv_slots();
+        // Allocated while the map is still intact, nothing below may throw
+        Prefilter new_prefilter;
+        new_prefilter.reset(new_capacity);
+
+        const auto old_ctrl_slots = get_ctrl_slots();
+        const auto old_kv_slots = get_kv_slots();
         const auto old_data = std::move(data_);
         const size_type old_capacity = capacity_;
+        const bool rehash_keys = new_seed != seed_;
 
+        seed_ = new_seed;
+        prefilter_ = std::move(new_prefilter);
         data_ = std::move(new_data);
         capacity_ = new_capacity;
-        ctrl_slot_t* __restrict ctrl_slots = reinterpret_cast<ctrl_slot_t*>(data_.get());
-        kv_slot_t* __restrict kv_slots = reinterpret_cast<kv_slot_t*>(data_.get() + ((sizeof(ctrl_slot_t) * capacity_ + alignof(kv_slot_t) - 1) & ~(alignof(kv_slot_t) - 1)));
-        std::uninitialized_default_construct_n(ctrl_slots, new_capacity);
+        max_dib_ = 0;
+        const auto ctrl_slots = get_ctrl_slots();
+        for (size_type idx = 0; idx < new_capacity; idx++)
+            std::construct_at(&ctrl_slots[idx]);
 
         for (size_type idx = 0; idx < old_capacity; idx++)
             if (!old_ctrl_slots[idx].is_empty()) [[likely]] {
-                insert_for_rehash(old_ctrl_slots[idx].hash, std::move(old_kv_slots[idx].kv()));
-                std::destroy_at(old_kv_slots[idx].kv_ptr());
+                if (rehash_keys || Prefilter::enabled) {
+                    const uint64_t hash = hash_of(old_kv_slots[idx].key());
+                    prefilter_.insert(hash);
+                    insert_for_rehash((size_type)hash, old_kv_slots[idx]);
+                }
+                else
+                    insert_for_rehash(old_ctrl_slots[idx].hash, old_kv_slots[idx]);
+            }
+    }
+
+    // Restores the Robin Hood order of a table that was filled by plain linear probing.
+    // Both schemes occupy the same set of slots, so it is enough to sort every cluster by initial bucket.
+    void restore_robin_hood_order() {
+        auto ctrl_slots = get_ctrl_slots();
+        auto kv_slots = get_kv_slots();
+
+        size_type start = 0;
+        for (; start < capacity_ && !ctrl_slots[start].is_empty(); start++);
+
+        if (start == capacity_) [[unlikely]] {
+            size_ = capacity_;
+            rehash(capacity_ * 3 / 2);
+            return;
+        }
+
+        auto initial_bucket = [&](size_type idx) -> size_type {
+            return ((uint64_t)ctrl_slots[idx].hash * (uint64_t)capacity_) >> 32;
+        };
+
+        // Distance from the empty slot at `start`, so that clusters wrapping around the end still sort correctly
+        auto unwrap = [&](size_type idx) -> size_type {
+            return idx > start ? idx - start : idx + capacity_ - start;
+        };
+
+        size_ = 0;
+        for (size_type offset = 1; offset < capacity_; offset++) {
+            size_type idx = start + offset < capacity_ ? start + offset : start + offset - capacity_;
+            if (ctrl_slots[idx].is_empty())
+                continue;
+
+            size_++;
+            while (true) {
+                size_type prev_idx = idx == 0 ? capacity_ - 1 : idx - 1;
+                if (ctrl_slots[prev_idx].is_empty() || unwrap(initial_bucket(prev_idx)) <= unwrap(initial_bucket(idx)))
+                    break;
+
+                std::swap(ctrl_slots[prev_idx], ctrl_slots[idx]);
+                swap_kv(kv_slots[prev_idx], kv_slots[idx]);
+                idx = prev_idx;
+            }
+        }
+
+        max_dib_ = 0;
+        for (size_type idx = 0; idx < capacity_; idx++)
+            if (!ctrl_slots[idx].is_empty()) {
+                size_type bucket = initial_bucket(idx);
+                ctrl_slots[idx].dib = idx >= bucket ? idx - bucket : idx + capacity_ - bucket;
+                max_dib_ = std::max(max_dib_, ctrl_slots[idx].dib);
             }
+
+        rebuild_prefilter();
     }
 
-    auto get_ctrl_slots() const noexcept -> ctrl_slot_t* {
-        return std::launder((ctrl_slot_t*)std::assume_aligned<alignof(ctrl_slot_t)>(data_.get()));
+    auto get_ctrl_slots() const noexcept -> slot_array_t<ctrl_slot_t> {
+        return slot_array_t<ctrl_slot_t>(data_.get());
     }
-    
-    auto get_kv_slots() const noexcept -> kv_slot_t* {
-        return std::launder((kv_slot_t*)std::assume_aligned<alignof(kv_slot_t)>(
-            data_.get() + ((sizeof(ctrl_slot_t) * capacity_ + alignof(kv_slot_t) - 1) & ~(alignof(kv_slot_t) - 1))
-        ));
+
+    auto get_kv_slots() const noexcept -> slot_array_t<kv_slot_t> {
+        return slot_array_t<kv_slot_t>(data_.get() + kv_slots_offset(capacity_));
     }
 
     template <typename H, typename K>
@@ -155,6 +437,9 @@ private:
 public:
     flat_hash_map() noexcept = default;
 
+    // Hashes keys with the given seed instead of a random one, 0 still picks a random seed
+    explicit flat_hash_map(const hash_seed seed) noexcept requires seedable_hash<Hash, Key> : seed_(seed.value) {}
+
     flat_hash_map(const std::initializer_list<std::pair<typename key_type_trait<Hash, Key>::insert_type, mapped_type>> init_list) {
         size_type required_capacity = 8;
         for (; required_capacity * 7 / 8 < init_list.size(); required_capacity = required_capacity * 3 / 2);
@@ -167,31 +452,15 @@ public:
         if (capacity_ == 0) [[unlikely]]
             return 0;
         
-        ctrl_slot_t* __restrict ctrl_slots = get_ctrl_slots();
-        const size_type hash = hash_func_(key);
+        auto ctrl_slots = get_ctrl_slots();
+        const size_type hash = (size_type)hash_of(key);
         size_type idx = ((uint64_t)(uint32_t)hash * (uint64_t)capacity_) >> 32;
         size_type dib = 0;
 
         while (!ctrl_slots[idx].is_empty()) {
             if (ctrl_slots[idx].hash == hash) [[unlikely]] {
-                if (kv_slot_t* kv_slots = get_kv_slots(); is_key_equal_(kv_slots[idx].key(), key)) [[likely]] {
-                    size_--;
-                    destroy_kv(ctrl_slots[idx], kv_slots[idx]);
-
-                    while (true) {
-                        size_type next_idx = idx + 1 == capacity_ ? 0 : idx + 1;;
-
-                        if (ctrl_slots[next_idx].is_empty() || ctrl_slots[next_idx].dib == 0) [[unlikely]]
-                            break;
-
-                        ctrl_slots[idx] = ctrl_slots[next_idx];
-                        std::construct_at(kv_slots[idx].kv_ptr(), std::move(kv_slots[next_idx].kv()));
-                        destroy_kv(ctrl_slots[next_idx], kv_slots[next_idx]);
-
-                        ctrl_slots[idx].dib--;
-                        idx = next_idx;
-                    }
-                    
+                if (is_key_equal_(get_kv_slots()[idx].key(), key)) [[likely]] {
+                    erase_slot(idx);
                     return 1;
                 }
             }
@@ -206,13 +475,23 @@ public:
         return 0;
     }
 
+    // Erases the element `pos` points to, which saves probing again after a find
+    void erase(iterator pos) noexcept {
+        erase_slot(pos.idx_);
+    }
+
     template <typename Self>
     auto find(this Self&& self, key_type_trait<Hash, Key>::query_type key) -> std::conditional_t<std::is_const_v<std::remove_reference_t<Self>>, const_iterator, iterator> {
         if (self.capacity_ == 0) [[unlikely]]
             return self.end();
 
-        const ctrl_slot_t* __restrict ctrl_slots = self.get_ctrl_slots();
-        const size_type hash = self.hash_func_(key);
+        const uint64_t full_hash = self.hash_of(key);
+        if (!self.prefilter_.may_contain(full_hash))
+            return self.end();
+
+        const size_type hash = (size_type)full_hash;
+
+        const auto ctrl_slots = self.get_ctrl_slots();
         size_type idx = ((uint64_t)(uint32_t)hash * (uint64_t)self.capacity_) >> 32;
         size_type dib = 0;
 
@@ -236,8 +515,9 @@ public:
         if (size_ >= capacity_ * 7 / 8) [[unlikely]]
             rehash(capacity_ == 0 ? 8 : capacity_ * 3 / 2);
 
-        ctrl_slot_t* __restrict ctrl_slots = get_ctrl_slots();
-        ctrl_slot_t ctrl_slot = { .hash = (size_type)hash_func_(key), .dib = 0 };
+        auto ctrl_slots = get_ctrl_slots();
+        const uint64_t full_hash = hash_of(key);
+        ctrl_slot_t ctrl_slot = { .hash = (size_type)full_hash, .dib = 0 };
         size_type idx = ((uint64_t)(uint32_t)ctrl_slot.hash * (uint64_t)capacity_) >> 32;
 
         while (true) {
@@ -245,19 +525,23 @@ public:
                 ctrl_slots[idx] = ctrl_slot;
                 std::construct_at(get_kv_slots()[idx].kv_ptr(), std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(args...));
                 size_++;
+                prefilter_.insert(full_hash);
+                if (record_dib(ctrl_slot.dib)) [[unlikely]]
+                    return { find(key), true };
                 return { iterator(this, idx), true };
             }
 
             if (ctrl_slots[idx].hash == ctrl_slot.hash) [[unlikely]]
-                if (kv_slot_t* kv_slots = get_kv_slots(); is_key_equal_(kv_slots[idx].key(), key)) [[likely]]
+                if (auto kv_slots = get_kv_slots(); is_key_equal_(kv_slots[idx].key(), key)) [[likely]]
                     return { iterator(this, idx), false };
             
             if (ctrl_slots[idx].dib < ctrl_slot.dib) [[unlikely]] {
-                typename kv_slot_t::kv_type new_kv(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(args...));
+                kv_slot_t kv;
+                std::construct_at(kv.kv_ptr(), std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(args...));
+                size_type placed_dib = ctrl_slot.dib;
+                prefilter_.insert(full_hash);
                 std::swap(ctrl_slots[idx], ctrl_slot);
-                auto& old_kv = get_kv_slots()[idx].kv();
-                auto kv = std::move(old_kv);
-                old_kv = std::move(new_kv);
+                swap_kv(get_kv_slots()[idx], kv);
                 size_type inserted_idx = idx;
                 
                 while (true) {
@@ -266,14 +550,17 @@ public:
 
                     if (ctrl_slots[idx].is_empty()) {
                         ctrl_slots[idx] = ctrl_slot;
-                        std::construct_at(get_kv_slots()[idx].kv_ptr(), std::move(kv));
+                        relocate_kv(get_kv_slots()[idx], kv);
                         size_++;
+                        if (record_dib(std::max(placed_dib, ctrl_slot.dib))) [[unlikely]]
+                            return { find(key), true };
                         return { iterator(this, inserted_idx), true };
                     }
 
                     if (ctrl_slots[idx].dib < ctrl_slot.dib) [[unlikely]] {
+                        placed_dib = std::max(placed_dib, ctrl_slot.dib);
                         std::swap(ctrl_slots[idx], ctrl_slot);
-                        std::swap(get_kv_slots()[idx].kv(), kv);
+                        swap_kv(get_kv_slots()[idx], kv);
                     }
                 }
 
@@ -307,6 +594,10 @@ public:
     auto size()  const noexcept -> size_type { return size_; }
     auto empty() const noexcept -> bool { return size_ == 0; }
     auto capacity() const noexcept -> size_type { return capacity_; }
+    auto max_dib() const noexcept -> size_type { return max_dib_; }
+    auto seed() const noexcept -> uint64_t { return seed_; }
+
+    auto prefilter_stats() const noexcept -> bloom_filter_stats requires Prefilter::enabled { return prefilter_.stats(); }
 
     auto contains(key_type_trait<Hash, Key>::query_type key) const noexcept -> bool { return find(key) != end(); }
 
@@ -314,13 +605,15 @@ public:
         if (capacity_ == 0) [[unlikely]]
             return;
 
-        ctrl_slot_t* __restrict ctrl_slots_ = get_ctrl_slots();
-        kv_slot_t* __restrict kv_slots_ = get_kv_slots();
+        auto ctrl_slots_ = get_ctrl_slots();
+        auto kv_slots_ = get_kv_slots();
 
         for (size_type idx = 0; idx < capacity_; idx++)
             if (!ctrl_slots_[idx].is_empty())
                 destroy_kv(ctrl_slots_[idx], kv_slots_[idx]);
         size_ = 0;
+        max_dib_ = 0;
+        prefilter_.clear();
     }
 
 
@@ -332,8 +625,11 @@ public:
         data_(std::move(other.data_)),
         capacity_(std::exchange(other.capacity_, 0)),
         size_(std::exchange(other.size_, 0)),
+        max_dib_(std::exchange(other.max_dib_, 0)),
+        seed_(other.seed_),
         hash_func_(std::move(other.hash_func_)),
-        is_key_equal_(std::move(other.is_key_equal_))
+        is_key_equal_(std::move(other.is_key_equal_)),
+        prefilter_(std::move(other.prefilter_))
     {}
 
     auto operator=(flat_hash_map&& other) noexcept -> flat_hash_map& {
@@ -342,8 +638,11 @@ public:
             data_ = std::move(other.data_);
             capacity_ = std::exchange(other.capacity_, 0);
             size_ = std::exchange(other.size_, 0);
+            max_dib_ = std::exchange(other.max_dib_, 0);
+            seed_ = other.seed_;
             hash_func_ = std::move(other.hash_func_);
             is_key_equal_ = std::move(other.is_key_equal_);
+            prefilter_ = std::move(other.prefilter_);
         }
         return *this;
     };
@@ -353,17 +652,19 @@ public:
 };
 
 
-template <typename Key, typename Value, typename Hash, typename KeyEqual>
-requires hashable<Hash, Key>
+template <typename Key, typename Value, typename Hash, typename KeyEqual, typename Layout, typename Prefilter>
+requires hashable<Hash, Key> && (std::same_as<Layout, soa_layout> || std::same_as<Layout, aos_layout>)
 template <bool is_const>
-class flat_hash_map<Key, Value, Hash, KeyEqual>::iterator_impl_t {
+class flat_hash_map<Key, Value, Hash, KeyEqual, Layout, Prefilter>::iterator_impl_t {
 private:
+    friend class flat_hash_map;
+
     using map_type = std::conditional_t<is_const, const flat_hash_map, flat_hash_map>;
     map_type* map_ = nullptr;
     map_type::size_type idx_ = 0;
 
     void skip_empty() noexcept {
-        ctrl_slot_t* __restrict ctrl_slots = map_->get_ctrl_slots();
+        auto ctrl_slots = map_->get_ctrl_slots();
         auto capacity = map_->capacity_;
         for (; idx_ < capacity && ctrl_slots[idx_].is_empty(); idx_++);
     }
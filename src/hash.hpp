@@ -20,6 +20,19 @@ struct hash<T> {
         }
         return hash;
     }
+
+    // The seed perturbs the FNV-1a offset basis, and the result is finalized so that keys
+    // sharing long prefixes or differing only in their last characters spread over all bits
+    constexpr static auto operator()(const std::string_view sv, const uint64_t seed) noexcept -> uint64_t {
+        uint64_t hash = 14695981039346656037ull ^ seed;
+        for (const char c : sv) {
+            hash ^= uint64_t(c);
+            hash *= 1099511628211ull;
+        }
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+        return hash ^ (hash >> 31);
+    }
 };
 
 template <typename T>
@@ -27,8 +40,8 @@ requires std::convertible_to<T, uint64_t>
 struct hash<T> {
     using is_transparent = void;
 
-    constexpr static auto operator()(const T val) noexcept -> uint64_t {
-        uint64_t hash = (uint64_t)val + 0x9e3779b97f4a7c15;
+    constexpr static auto operator()(const T val, const uint64_t seed = 0) noexcept -> uint64_t {
+        uint64_t hash = ((uint64_t)val ^ seed) + 0x9e3779b97f4a7c15;
         hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
         hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
         hash = hash ^ (hash >> 31);
@@ -40,4 +53,15 @@ template <typename Hash, typename Key>
 concept hashable = requires(Hash hash_func, const Key& key) {
     { hash_func(key) } -> std::convertible_to<size_t>;
 };
+
+// Tags a seed passed to a container, so that it cannot be mistaken for a size
+struct hash_seed {
+    uint64_t value = 0;
+};
+
+// Hash functions that also accept a per-container seed
+template <typename Hash, typename Key>
+concept seedable_hash = hashable<Hash, Key> && requires(Hash hash_func, const Key& key, const uint64_t seed) {
+    { hash_func(key, seed) } -> std::convertible_to<size_t>;
+};
 }
\ No newline at end of file
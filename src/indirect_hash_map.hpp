@@ -0,0 +1,251 @@
+#pragma once
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "./flat_hash_map.hpp"
+
+namespace ineffa {
+
+// Hash map for large mapped types. The table slots only hold the key and a 32-bit index,
+// the values live out of line in a slab with stable addresses, so probing and Robin Hood
+// displacement never touch them and pointers to values survive rehash.
+// Iteration follows the table order of the index, not the slab order, so it visits the values
+// at scattered addresses. Dereferencing an iterator yields a pair of references by value, bind
+// it with `const auto&` or `auto` rather than `auto&`.
+template <typename Key, typename Value, typename Hash = ineffa::hash<Key>, typename KeyEqual = std::equal_to<>>
+requires hashable<Hash, Key>
+class indirect_hash_map {
+private:
+    template <bool is_const>
+    class iterator_impl_t;
+
+public:
+    using key_type        = Key;
+    using mapped_type     = Value;
+    using size_type       = uint32_t;
+    using difference_type = std::ptrdiff_t;
+    using hasher          = Hash;
+    using key_equal       = KeyEqual;
+    using iterator        = iterator_impl_t<false>;
+    using const_iterator  = iterator_impl_t<true>;
+
+private:
+    using index_map_type = flat_hash_map<Key, size_type, Hash, KeyEqual>;
+    using query_type = typename index_map_type::template key_type_trait<Hash, Key>::query_type;
+
+    // Values are allocated in fixed-size chunks that never move. Freed entries form an intrusive
+    // list threaded through their own storage and are reused before the slab grows.
+    class value_slab_t {
+    private:
+        static constexpr size_type CHUNK_SHIFT = 6;
+        static constexpr size_type CHUNK_SIZE = size_type(1) << CHUNK_SHIFT;
+        static constexpr size_type NONE = std::numeric_limits<size_type>::max();
+
+        struct value_slot_t {
+            alignas(Value) alignas(size_type) std::byte data_[std::max(sizeof(Value), sizeof(size_type))];
+        };
+
+        std::vector<std::unique_ptr<value_slot_t[]>> chunks_;
+        size_type used_ = 0;  // Number of entries handed out at least once
+        size_type free_head_ = NONE;
+
+        auto slot(const size_type idx) const noexcept -> value_slot_t& {
+            return chunks_[idx >> CHUNK_SHIFT][idx & (CHUNK_SIZE - 1)];
+        }
+
+    public:
+        auto operator[](const size_type idx) const noexcept -> Value& {
+            return *std::launder((Value*)slot(idx).data_);
+        }
+
+        template <typename... Args>
+        auto emplace(Args&&... args) -> size_type {
+            if (free_head_ != NONE) {
+                const size_type idx = free_head_;
+                std::memcpy(&free_head_, slot(idx).data_, sizeof(size_type));
+                try {
+                    std::construct_at((Value*)slot(idx).data_, std::forward<Args>(args)...);
+                }
+                catch (...) {
+                    // The constructor may have overwritten the link before throwing
+                    std::memcpy(slot(idx).data_, &free_head_, sizeof(size_type));
+                    free_head_ = idx;
+                    throw;
+                }
+                return idx;
+            }
+
+            if ((used_ >> CHUNK_SHIFT) == chunks_.size())
+                chunks_.push_back(std::make_unique_for_overwrite<value_slot_t[]>(CHUNK_SIZE));
+
+            std::construct_at((Value*)slot(used_).data_, std::forward<Args>(args)...);
+            return used_++;
+        }
+
+        void erase(const size_type idx) noexcept {
+            std::destroy_at(&(*this)[idx]);
+            std::memcpy(slot(idx).data_, &free_head_, sizeof(size_type));
+            free_head_ = idx;
+        }
+
+        // Forgets all entries but keeps the chunks, the values must have been destroyed already
+        void reset() noexcept {
+            used_ = 0;
+            free_head_ = NONE;
+        }
+    };
+
+    index_map_type index_;
+    value_slab_t values_;
+
+public:
+    indirect_hash_map() noexcept = default;
+
+    indirect_hash_map(const std::initializer_list<std::pair<typename index_map_type::template key_type_trait<Hash, Key>::insert_type, mapped_type>> init_list) {
+        for (const auto& kv : init_list)
+            insert(kv);
+    }
+
+    auto erase(query_type key) -> size_type {
+        auto it = index_.find(key);
+        if (it == index_.end())
+            return 0;
+
+        const size_type value_idx = it->second;
+        index_.erase(it);
+        values_.erase(value_idx);
+        return 1;
+    }
+
+    template <typename Self>
+    auto find(this Self&& self, query_type key) -> std::conditional_t<std::is_const_v<std::remove_reference_t<Self>>, const_iterator, iterator> {
+        return { &self, self.index_.find(key) };
+    }
+
+    template <typename... Args>
+    auto try_emplace(query_type key, Args&&... args) -> std::pair<iterator, bool> {
+        auto [it, inserted] = index_.try_emplace(key);
+
+        if (inserted) {
+            try {
+                it->second = values_.emplace(std::forward<Args>(args)...);
+            }
+            catch (...) {
+                index_.erase(it);
+                throw;
+            }
+        }
+
+        return { iterator(this, it), inserted };
+    }
+
+    auto insert(std::pair<query_type, mapped_type> key_and_value) -> std::pair<iterator, bool> {
+        return try_emplace(key_and_value.first, std::move(key_and_value.second));
+    }
+
+    auto operator[](query_type key) -> mapped_type& {
+        return try_emplace(key).first->second;
+    }
+
+    auto begin() noexcept -> iterator { return iterator(this, index_.begin()); }
+    auto end()   noexcept -> iterator { return iterator(this, index_.end()); }
+
+    auto begin() const noexcept -> const_iterator { return const_iterator(this, index_.begin()); }
+    auto end()   const noexcept -> const_iterator { return const_iterator(this, index_.end()); }
+
+    auto cbegin() const noexcept -> const_iterator { return begin(); }
+    auto cend()   const noexcept -> const_iterator { return end(); }
+
+    auto size()  const noexcept -> size_type { return index_.size(); }
+    auto empty() const noexcept -> bool { return index_.empty(); }
+    auto capacity() const noexcept -> size_type { return index_.capacity(); }
+
+    auto contains(query_type key) const noexcept -> bool { return index_.contains(key); }
+
+    void clear() noexcept {
+        for (const auto& [key, value_idx] : index_)
+            std::destroy_at(&values_[value_idx]);
+        index_.clear();
+        values_.reset();
+    }
+
+    ~indirect_hash_map() noexcept {
+        clear();
+    }
+
+    indirect_hash_map(indirect_hash_map&& other) noexcept :
+        index_(std::move(other.index_)),
+        values_(std::exchange(other.values_, {}))
+    {}
+
+    auto operator=(indirect_hash_map&& other) noexcept -> indirect_hash_map& {
+        if (this != &other) [[likely]] {
+            clear();
+            index_ = std::move(other.index_);
+            values_ = std::exchange(other.values_, {});
+        }
+        return *this;
+    }
+
+    indirect_hash_map(const indirect_hash_map&) = delete;
+    indirect_hash_map& operator=(const indirect_hash_map&) = delete;
+};
+
+
+template <typename Key, typename Value, typename Hash, typename KeyEqual>
+requires hashable<Hash, Key>
+template <bool is_const>
+class indirect_hash_map<Key, Value, Hash, KeyEqual>::iterator_impl_t {
+private:
+    template <bool>
+    friend class iterator_impl_t;
+
+    using map_type = std::conditional_t<is_const, const indirect_hash_map, indirect_hash_map>;
+    using index_iterator = std::conditional_t<is_const, typename index_map_type::const_iterator, typename index_map_type::iterator>;
+    map_type* map_ = nullptr;
+    index_iterator it_;
+
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using difference_type = std::ptrdiff_t;
+    using value_type = std::pair<const Key, Value>;
+    using reference = std::pair<const Key&, std::conditional_t<is_const, const Value&, Value&>>;
+
+    // The key and the value are stored apart, so dereferencing yields a pair of references
+    struct pointer {
+        reference ref;
+        auto operator->() noexcept -> reference* { return &ref; }
+    };
+
+    iterator_impl_t() noexcept = default;
+
+    iterator_impl_t(map_type* map, index_iterator it) noexcept : map_(map), it_(it) {}
+
+    auto operator*() const noexcept -> reference {
+        return { it_->first, map_->values_[it_->second] };
+    }
+
+    auto operator->() const noexcept -> pointer {
+        return { **this };
+    }
+
+    auto operator++() noexcept -> iterator_impl_t& {
+        ++it_;
+        return *this;
+    }
+
+    auto operator++(int) noexcept -> iterator_impl_t {
+        iterator_impl_t tmp = *this;
+        ++(*this);
+        return tmp;
+    }
+
+    template <bool C>
+    bool operator==(const iterator_impl_t<C>& other) const noexcept { return it_ == other.it_; }
+
+    template <bool C>
+    bool operator!=(const iterator_impl_t<C>& other) const noexcept { return it_ != other.it_; }
+};
+
+} // namespace ineffa
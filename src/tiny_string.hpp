@@ -3,6 +3,7 @@
 #include <memory>
 #include <string_view>
 #include <utility>
+#include "./type_traits.hpp"
 
 namespace ineffa {
 class alignas(char*) tiny_string {
@@ -85,4 +86,8 @@ auto operator<=>(const tiny_string& lhs, const T& rhs) noexcept {
     return lhs.sv() <=> std::string_view(rhs);
 }
 
+// The heap buffer is owned through a plain pointer, so the bytes can be moved as they are
+template <>
+struct is_trivially_relocatable<tiny_string> : std::true_type {};
+
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+#pragma once
+#include <type_traits>
+#include <utility>
+
+namespace ineffa {
+// A type is trivially relocatable if moving an object to a new address and ending the lifetime of the old one
+// is equivalent to a memcpy. Specialize it for types that own resources but hold no pointers into themselves.
+template <typename T>
+struct is_trivially_relocatable : std::bool_constant<std::is_trivially_copyable_v<T>> {};
+
+template <typename T, typename U>
+struct is_trivially_relocatable<std::pair<T, U>> : std::bool_constant<is_trivially_relocatable<T>::value && is_trivially_relocatable<U>::value> {};
+
+template <typename T>
+inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+}
@@ -0,0 +1,123 @@
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <print>
+
+#include "../src/flat_hash_map.hpp"
+
+
+// Benchmarks flat_hash_map policies on uint64_t -> uint32_t entries:
+// - soa_layout against aos_layout on hits, misses and iteration
+// - no_prefilter against blocked_bloom_filter on lookups with a varying share of hits
+// Usage: bench_flat_hash_map [entry count], the default is large enough to spill out of the caches.
+
+constexpr uint64_t KEY_STEP = 0x9e3779b97f4a7c15;  // Odd, so i * KEY_STEP is a bijection
+
+// Cheap generator, so that the timed loops are dominated by the map
+struct xorshift64 {
+    uint64_t state = 0x2545f4914f6cdd1d;
+
+    auto operator()() noexcept -> uint64_t {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+};
+
+template <typename Fn>
+void measure(const char* name, const uint64_t op_count, Fn&& fn) {
+    const auto start = std::chrono::steady_clock::now();
+    const uint64_t checksum = fn();
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::println("    {:<20} {:>8.2f} ns/op  (checksum {})", name, elapsed.count() / op_count, checksum);
+}
+
+template <typename Layout>
+void bench_layout(const char* layout_name, const uint32_t entry_count, const uint64_t lookup_count) {
+    ineffa::flat_hash_map<uint64_t, uint32_t, ineffa::hash<uint64_t>, std::equal_to<>, Layout> map(ineffa::hash_seed { 1 });
+    for (uint32_t i = 0; i < entry_count; i++)
+        map[i * KEY_STEP] = i;
+
+    std::println("{}: {} entries, capacity {}", layout_name, map.size(), map.capacity());
+
+    // Each key depends on the previous result, so every lookup pays its full latency
+    measure("dependent hits", lookup_count, [&] {
+        xorshift64 rng;
+        uint32_t value = 0;
+        for (uint64_t i = 0; i < lookup_count; i++)
+            value = map.find(((rng() ^ value) % entry_count) * KEY_STEP)->second;
+        return (uint64_t)value;
+    });
+
+    // Independent lookups let the CPU overlap the cache misses of several probes
+    measure("independent hits", lookup_count, [&] {
+        xorshift64 rng;
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < lookup_count; i++)
+            sum += map.find((rng() % entry_count) * KEY_STEP)->second;
+        return sum;
+    });
+
+    measure("misses", lookup_count, [&] {
+        xorshift64 rng;
+        uint64_t found = 0;
+        for (uint64_t i = 0; i < lookup_count; i++)
+            found += map.contains((entry_count + rng() % entry_count) * KEY_STEP);
+        return found;
+    });
+
+    measure("iteration", map.size(), [&] {
+        uint64_t sum = 0;
+        for (const auto& [key, value] : map)
+            sum += value;
+        return sum;
+    });
+}
+
+template <typename Prefilter>
+void bench_prefilter(const char* prefilter_name, const uint32_t entry_count, const uint64_t lookup_count) {
+    ineffa::flat_hash_map<uint64_t, uint32_t, ineffa::hash<uint64_t>, std::equal_to<>, ineffa::soa_layout, Prefilter> map(ineffa::hash_seed { 1 });
+    for (uint32_t i = 0; i < entry_count; i++)
+        map[i * KEY_STEP] = i;
+
+    std::println("{}: {} entries, capacity {}", prefilter_name, map.size(), map.capacity());
+    if constexpr (Prefilter::enabled) {
+        const auto stats = map.prefilter_stats();
+        std::println("    filter uses {} bytes, expected false positive rate {:.4f}", stats.memory_bytes, stats.false_positive_rate);
+    }
+
+    // Keys below entry_count are present, the ones above are not
+    auto lookup = [&](const char* name, const uint32_t hit_percent) {
+        measure(name, lookup_count, [&] {
+            xorshift64 rng;
+            uint64_t found = 0;
+            for (uint64_t i = 0; i < lookup_count; i++) {
+                const uint64_t r = rng();
+                const uint64_t base = r % 100 < hit_percent ? 0 : entry_count;
+                found += map.contains((base + (r >> 8) % entry_count) * KEY_STEP);
+            }
+            return found;
+        });
+    };
+
+    lookup("0% hits", 0);
+    lookup("10% hits", 10);
+    lookup("50% hits", 50);
+    lookup("100% hits", 100);
+}
+
+auto main(int argc, char** argv) -> int try {
+    const uint32_t entry_count = argc > 1 ? (uint32_t)std::stoul(argv[1]) : uint32_t(1) << 22;
+    const uint64_t lookup_count = uint64_t(entry_count) * 2;
+
+    bench_layout<ineffa::soa_layout>("soa_layout", entry_count, lookup_count);
+    bench_layout<ineffa::aos_layout>("aos_layout", entry_count, lookup_count);
+    bench_prefilter<ineffa::no_prefilter>("no_prefilter", entry_count, lookup_count);
+    bench_prefilter<ineffa::blocked_bloom_filter<>>("blocked_bloom_filter<10>", entry_count, lookup_count);
+    return 0;
+}
+catch(std::exception& e) {
+    std::println(stderr, "fetal error: {}", e.what());
+    return -1;
+}
@@ -0,0 +1,147 @@
+#include <atomic>
+#include <chrono>
+#include <source_location>
+#include <string>
+#include <thread>
+#include <vector>
+#include <print>
+
+#include "../src/concurrent_flat_hash_map.hpp"
+#include "../src/tiny_string.hpp"
+
+
+void test_concurrent_flat_hash_map() {
+    auto check = [](bool condition, const char* expr, const std::source_location loc = std::source_location::current()) {
+        if (!condition) [[unlikely]] {
+            std::println(stderr, "Test Failed in {}:{}", loc.file_name(), loc.line());
+            std::println(stderr, "Expr: {}", expr);
+            std::abort();
+        }
+    };
+
+    #define CHECK(...) check(__VA_ARGS__, #__VA_ARGS__)
+
+    // Single-threaded insert_or_get, find and freeze
+    {
+        ineffa::concurrent_flat_hash_map<ineffa::tiny_string, int, ineffa::hash<std::string_view>> map(3);
+        CHECK(map.insert_or_get("Alice", 100).second);
+        CHECK(map.insert_or_get("Bob", 200).second);
+
+        auto [value, inserted] = map.insert_or_get("Alice", 999);
+        CHECK(!inserted);
+        CHECK(value == 100);
+        CHECK(map.find("Ghost") == nullptr);
+        CHECK(*map.find("Bob") == 200);
+
+        auto frozen = std::move(map).freeze();
+        CHECK(frozen.size() == 2);
+        CHECK(frozen["Alice"] == 100);
+        CHECK(!frozen.contains("Ghost"));
+    }
+
+    // Overlapping parallel inserts, every key must be inserted exactly once
+    {
+        constexpr int THREAD_COUNT = 8;
+        constexpr uint64_t TEST_SIZE = 100000;
+        ineffa::concurrent_flat_hash_map<uint64_t, uint64_t> map(TEST_SIZE);
+        std::atomic<uint64_t> inserted_count = 0;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREAD_COUNT; t++)
+            threads.emplace_back([&, t] {
+                uint64_t local_count = 0;
+                for (uint64_t i = 0; i < TEST_SIZE; i++) {
+                    uint64_t key = (i * 7 + t * 12345) % TEST_SIZE;
+                    auto [value, inserted] = map.insert_or_get(key, key * 10);
+                    local_count += inserted;
+                    if (value != key * 10) [[unlikely]]
+                        std::abort();
+                }
+                inserted_count += local_count;
+            });
+
+        for (auto& thread : threads)
+            thread.join();
+
+        CHECK(inserted_count == TEST_SIZE);
+
+        auto frozen = std::move(map).freeze();
+        CHECK(frozen.size() == TEST_SIZE);
+        for (uint64_t key = 0; key < TEST_SIZE; key++)
+            CHECK(frozen.find(key) != frozen.end() && frozen.find(key)->second == key * 10);
+        CHECK(!frozen.contains(TEST_SIZE));
+
+        // The frozen map is a regular flat_hash_map
+        for (uint64_t key = 0; key < TEST_SIZE; key += 2)
+            CHECK(frozen.erase(key) == 1);
+        for (uint64_t key = TEST_SIZE; key < TEST_SIZE * 2; key++)
+            frozen[key] = key * 10;
+        CHECK(frozen.size() == TEST_SIZE / 2 + TEST_SIZE);
+        CHECK(!frozen.contains(0));
+        CHECK(frozen[1] == 10);
+        CHECK(frozen[TEST_SIZE * 2 - 1] == (TEST_SIZE * 2 - 1) * 10);
+    }
+
+    // Readers of a key whose insert is still in flight wait for it to be published, even when
+    // the threads outnumber the cores and the writer gets descheduled mid-construction
+    {
+        struct slow_value {
+            uint64_t value = 0;
+            explicit slow_value(uint64_t v) noexcept : value(v) {}
+            slow_value(slow_value&& other) noexcept : value(other.value) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            auto operator=(slow_value&& other) noexcept -> slow_value& {
+                value = other.value;
+                return *this;
+            }
+        };
+
+        constexpr int THREAD_COUNT = 32;
+        ineffa::concurrent_flat_hash_map<uint64_t, slow_value> map(THREAD_COUNT);
+        std::atomic<int> inserted_count = 0;
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < THREAD_COUNT; t++)
+            threads.emplace_back([&, t] {
+                for (uint64_t key = 0; key < 4; key++) {
+                    auto [value, inserted] = map.insert_or_get(key, key * 10 + t % 2);
+                    inserted_count += inserted;
+                    if (value.value / 10 != key) [[unlikely]]
+                        std::abort();
+                }
+            });
+
+        for (auto& thread : threads)
+            thread.join();
+
+        CHECK(inserted_count == 4);
+        for (uint64_t key = 0; key < 4; key++)
+            CHECK(map.find(key) != nullptr && map.find(key)->value / 10 == key);
+    }
+
+    // Exceeding the fixed capacity
+    {
+        ineffa::concurrent_flat_hash_map<uint64_t, int> map(1);
+        bool thrown = false;
+        try {
+            for (uint64_t key = 0; key <= map.capacity(); key++)
+                map.insert_or_get(key, 0);
+        }
+        catch (const std::length_error&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+    }
+}
+
+auto main() -> int try {
+    std::println("Starting ineffa::concurrent_flat_hash_map tests...");
+    test_concurrent_flat_hash_map();
+    std::println("All ineffa::concurrent_flat_hash_map tests passed successfully");
+    return 0;
+}
+catch(std::exception& e) {
+    std::println(stderr, "fetal error: {}", e.what());
+    return -1;
+}
@@ -7,10 +7,22 @@
 #include "../src/tiny_string.hpp"
 
 
-template <typename K = std::string>
+// Sends every key to the same bucket while the map uses CLUSTERED_SEED
+constexpr uint64_t CLUSTERED_SEED = 42;
+
+struct clustered_hash {
+    using transparent_type = const std::string_view;
+
+    static auto operator()(const std::string_view sv, const uint64_t seed = 0) noexcept -> uint64_t {
+        return seed == CLUSTERED_SEED ? 0 : ineffa::hash<std::string_view>{}(sv, seed);
+    }
+};
+
+
+template <typename K = std::string, typename Layout = ineffa::soa_layout>
 requires std::constructible_from<std::string_view, K> && std::convertible_to<K, std::string_view>
 void test_flat_hash_map() {
-    using MapType = ineffa::flat_hash_map<K, int, ineffa::hash<std::string_view>>;
+    using MapType = ineffa::flat_hash_map<K, int, ineffa::hash<std::string_view>, std::equal_to<>, Layout>;
 
     auto check = [](bool condition, const char* expr, const std::source_location loc = std::source_location::current()) {
         if (!condition) [[unlikely]] {
@@ -107,9 +119,92 @@ void test_flat_hash_map() {
         CHECK(map2.capacity() > 0);
     }
     
+    // Backward shift and rehash of heap-allocated keys, relocated without move constructors
+    {
+        static_assert(ineffa::is_trivially_relocatable_v<std::pair<ineffa::tiny_string, int>>);
+        static_assert(!ineffa::is_trivially_relocatable_v<std::pair<ineffa::tiny_string, std::string>>);
+
+        MapType map;
+        constexpr int TEST_SIZE = 10000;
+        for (int i = 0; i < TEST_SIZE; ++i)
+            map["a rather long key #" + std::to_string(i)] = i;
+
+        for (int i = 0; i < TEST_SIZE; i += 3)
+            CHECK(map.erase("a rather long key #" + std::to_string(i)) == 1);
+
+        for (int i = 0; i < TEST_SIZE; ++i) {
+            auto it = map.find("a rather long key #" + std::to_string(i));
+            CHECK((it == map.end()) == (i % 3 == 0));
+            CHECK(it == map.end() || it->second == i);
+        }
+    }
+
+    // Probe length guard: keys whose hashes all land in the same bucket force a reseed
+    {
+        ineffa::flat_hash_map<K, int, clustered_hash, std::equal_to<>, Layout> map(ineffa::hash_seed { CLUSTERED_SEED });
+        constexpr int TEST_SIZE = 1000;
+        for (int i = 0; i < TEST_SIZE; ++i)
+            map[std::to_string(i)] = i;
+
+        CHECK(map.size() == TEST_SIZE);
+        CHECK(map.seed() != CLUSTERED_SEED);
+        CHECK(map.max_dib() < 64);
+        for (int i = 0; i < TEST_SIZE; ++i)
+            CHECK(map[std::to_string(i)] == i);
+    }
+
+    // Every map draws its own seed unless one is given
+    {
+        MapType first, second;
+        first["key"] = 1;
+        second["key"] = 2;
+        CHECK(first.seed() != 0 && second.seed() != 0);
+        CHECK(first.seed() != second.seed());
+
+        MapType seeded(ineffa::hash_seed { 12345 });
+        seeded["key"] = 3;
+        CHECK(seeded.seed() == 12345);
+        CHECK(seeded["key"] == 3);
+    }
+
+    // Bloom prefilter stays in sync with insertions, rehash and erase-heavy workloads
+    {
+        ineffa::flat_hash_map<K, int, ineffa::hash<std::string_view>, std::equal_to<>, Layout, ineffa::blocked_bloom_filter<>> map;
+        constexpr int TEST_SIZE = 10000;
+        for (int i = 0; i < TEST_SIZE; ++i)
+            map[std::to_string(i)] = i;
+
+        for (int i = 0; i < TEST_SIZE; ++i)
+            CHECK(map.find(std::to_string(i)) != map.end());
+
+        for (int i = TEST_SIZE; i < TEST_SIZE * 2; ++i)
+            CHECK(!map.contains(std::to_string(i)));
+
+        auto stats = map.prefilter_stats();
+        CHECK(stats.memory_bytes > 0);
+        CHECK(stats.false_positive_rate > 0 && stats.false_positive_rate < 0.05);
+
+        for (int i = 0; i < TEST_SIZE; ++i)
+            if (i % 4 != 0)
+                CHECK(map.erase(std::to_string(i)) == 1);
+        CHECK(map.prefilter_stats().false_positive_rate < stats.false_positive_rate);
+        for (int i = 0; i < TEST_SIZE; ++i)
+            CHECK(map.contains(std::to_string(i)) == (i % 4 == 0));
+
+        auto moved = std::move(map);
+        CHECK(map.prefilter_stats().memory_bytes == 0);
+        CHECK(map.prefilter_stats().false_positive_rate == 0);
+        CHECK(!map.contains("0"));
+        CHECK(moved.contains("0"));
+
+        moved.clear();
+        CHECK(!moved.contains("1"));
+        CHECK(moved.prefilter_stats().false_positive_rate == 0);
+    }
+
     // Destructor test (RAII check)
     {
-        ineffa::flat_hash_map<K, std::vector<int>, ineffa::hash<std::string_view>> map;
+        ineffa::flat_hash_map<K, std::vector<int>, ineffa::hash<std::string_view>, std::equal_to<>, Layout> map;
         map["Vector1"] = { 1, 2, 3, 4, 5 };
         map.erase("Vector1");
         CHECK(map.empty());
@@ -119,7 +214,8 @@ void test_flat_hash_map() {
 
 auto main() -> int try {
     std::println("Starting ineffa::flat_hash_map tests...");
-    test_flat_hash_map<ineffa::tiny_string>();
+    test_flat_hash_map<ineffa::tiny_string, ineffa::soa_layout>();
+    test_flat_hash_map<ineffa::tiny_string, ineffa::aos_layout>();
     std::println("All ineffa::flat_hash_map tests passed successfully");
     return 0;
 }
@@ -0,0 +1,138 @@
+#include <array>
+#include <source_location>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <print>
+
+#include "../src/indirect_hash_map.hpp"
+#include "../src/tiny_string.hpp"
+
+
+void test_indirect_hash_map() {
+    using MapType = ineffa::indirect_hash_map<ineffa::tiny_string, std::string, ineffa::hash<std::string_view>>;
+
+    auto check = [](bool condition, const char* expr, const std::source_location loc = std::source_location::current()) {
+        if (!condition) [[unlikely]] {
+            std::println(stderr, "Test Failed in {}:{}", loc.file_name(), loc.line());
+            std::println(stderr, "Expr: {}", expr);
+            std::abort();
+        }
+    };
+
+    #define CHECK(...) check(__VA_ARGS__, #__VA_ARGS__)
+
+    // Initialization, insertion and query
+    {
+        MapType map;
+        CHECK(map.empty());
+        CHECK(map.find("Ghost") == map.end());
+
+        map = {{"Alice", "100"}, {"Bob", "200"}};
+        CHECK(map.size() == 2);
+        CHECK(map.contains("Alice"));
+        CHECK(map["Bob"] == "200");
+
+        auto [it, inserted] = map.try_emplace("Alice", "999");
+        CHECK(!inserted);
+        CHECK(it->second == "100");
+        CHECK(it->first == "Alice");
+    }
+
+    // Value addresses are stable across rehash, freed entries are reused
+    {
+        MapType map;
+        std::string* first = &map["0"];
+        *first = "first";
+
+        constexpr int TEST_SIZE = 10000;
+        for (int i = 1; i < TEST_SIZE; ++i)
+            map[std::to_string(i)] = std::to_string(i * 10);
+
+        CHECK(map.size() == TEST_SIZE);
+        CHECK(&map["0"] == first);
+        CHECK(*first == "first");
+        CHECK(map["9999"] == "99990");
+
+        std::string* erased = &map["500"];
+        CHECK(map.erase("500") == 1);
+        CHECK(map.erase("500") == 0);
+        CHECK(!map.contains("500"));
+        CHECK(&map["new"] == erased);
+        CHECK(map["new"].empty());
+    }
+
+    // A throwing constructor leaves the free list intact
+    {
+        struct throwing_value {
+            std::string text;
+            throwing_value() = default;
+            explicit throwing_value(bool fail) : text(64, 'x') {
+                if (fail)
+                    throw std::runtime_error("throwing_value");
+            }
+        };
+
+        ineffa::indirect_hash_map<int, throwing_value> map;
+        map[1].text = "one";
+        map[2].text = "two";
+        map[3].text = "three";
+        CHECK(map.erase(1) == 1);
+        CHECK(map.erase(2) == 1);
+
+        bool thrown = false;
+        try {
+            map.try_emplace(4, true);
+        }
+        catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        CHECK(thrown);
+        CHECK(!map.contains(4));
+
+        throwing_value* fifth = &map[5];
+        throwing_value* sixth = &map[6];
+        throwing_value* seventh = &map[7];
+        CHECK(fifth != sixth && sixth != seventh && fifth != seventh);
+        CHECK(&map[3] != fifth && &map[3] != sixth && &map[3] != seventh);
+        CHECK(map[3].text == "three");
+        CHECK(map.size() == 4);
+    }
+
+    // Iteration and Clear
+    {
+        ineffa::indirect_hash_map<uint64_t, std::array<uint64_t, 32>> map;
+        for (uint64_t i = 0; i < 100; ++i)
+            map[i].fill(i);
+
+        size_t count = 0;
+        uint64_t sum = 0;
+        for (const auto& [k, v] : map) {
+            count++;
+            sum += v[31];
+            CHECK(k == v[0]);
+        }
+        CHECK(count == 100);
+        CHECK(sum == 4950);
+
+        auto moved = std::move(map);
+        CHECK(map.empty());
+        CHECK(moved[42][0] == 42);
+
+        moved.clear();
+        CHECK(moved.empty());
+        moved[7].fill(7);
+        CHECK(moved.find(7)->second[3] == 7);
+    }
+}
+
+auto main() -> int try {
+    std::println("Starting ineffa::indirect_hash_map tests...");
+    test_indirect_hash_map();
+    std::println("All ineffa::indirect_hash_map tests passed successfully");
+    return 0;
+}
+catch(std::exception& e) {
+    std::println(stderr, "fetal error: {}", e.what());
+    return -1;
+}